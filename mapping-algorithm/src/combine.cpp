@@ -0,0 +1,127 @@
+#include "combine.h"
+#include "hash.h"
+#include "types.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define EMPTY_TAG 0ull
+#define NO_KEY UINT32_MAX
+
+struct CombinerSlot
+{
+  std::atomic<u64> tag;
+  std::atomic<u32> key_idx;
+  std::atomic<u32> count;
+};
+
+static u64 digest_prefix(unsigned char *h)
+{
+  u64 prefix = *(reinterpret_cast<u64 *>(h));
+  // 0 marks an empty slot, a real 0 prefix shares its probe chain with 1
+  return prefix == EMPTY_TAG ? 1ull : prefix;
+}
+
+// lowers slot->key_idx to i so the representative is always the first occurrence
+static void claim_lowest(CombinerSlot *slot, u32 i)
+{
+  u32 cur = slot->key_idx.load(std::memory_order_acquire);
+  while (i < cur && !slot->key_idx.compare_exchange_weak(cur, i, std::memory_order_acq_rel))
+  {
+  }
+}
+
+// concurrent open-addressing (linear probing) table keyed by the 64-bit
+// digest prefix. slots are claimed with a CAS on the tag, and a prefix match
+// is confirmed against the full key and op code before a copy is folded in.
+void combine_keys(std::vector<std::vector<u32>> *in_vecs,
+                  local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
+                  const local_vector<size_t> *op_codes, CombinedKeys *out)
+{
+  size_t n = in_hashes->size();
+  size_t cap = 2;
+  while (cap < 2 * n)
+    cap <<= 1;
+  size_t mask = cap - 1;
+
+  std::unique_ptr<CombinerSlot[]> table(new CombinerSlot[cap]);
+#pragma omp parallel for schedule(static)
+  for (size_t s = 0; s < cap; s++)
+  {
+    table[s].tag.store(EMPTY_TAG, std::memory_order_relaxed);
+    table[s].key_idx.store(NO_KEY, std::memory_order_relaxed);
+    table[s].count.store(0, std::memory_order_relaxed);
+  }
+
+  local_vector<u32> slot_of(n);
+
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+  {
+    u64 prefix = digest_prefix(in_hashes->at(i).data());
+    size_t s = prefix & mask;
+    for (;; s = (s + 1) & mask)
+    {
+      CombinerSlot *slot = &table[s];
+      u64 tag = slot->tag.load(std::memory_order_acquire);
+      if (tag == EMPTY_TAG)
+      {
+        if (!slot->tag.compare_exchange_strong(tag, prefix, std::memory_order_acq_rel))
+        {
+          // lost the race, tag now holds the winner's prefix
+          if (tag != prefix)
+            continue;
+        }
+        else
+        {
+          claim_lowest(slot, (u32)i);
+          slot->count.fetch_add(1, std::memory_order_relaxed);
+          slot_of[i] = s;
+          break;
+        }
+      }
+      if (tag != prefix)
+        continue;
+
+      // the winner may not have published its key yet, give up the cpu in
+      // case it was descheduled between claiming the tag and the key
+      u32 rep;
+      while ((rep = slot->key_idx.load(std::memory_order_acquire)) == NO_KEY)
+      {
+        std::this_thread::yield();
+      }
+      bool same_op = op_codes == nullptr || op_codes->at(rep) == op_codes->at(i);
+      if (same_op && compare_veci(&in_vecs->at(rep), &in_vecs->at(i)) == 0)
+      {
+        claim_lowest(slot, (u32)i);
+        slot->count.fetch_add(1, std::memory_order_relaxed);
+        slot_of[i] = s;
+        break;
+      }
+    }
+  }
+
+  // a key is kept if it is the representative of its slot, which preserves key order
+  out->key_indices.clear();
+  out->multiplicities.clear();
+  for (size_t i = 0; i < n; i++)
+  {
+    CombinerSlot *slot = &table[slot_of[i]];
+    if (slot->key_idx.load(std::memory_order_relaxed) == i)
+    {
+      out->key_indices.push_back((u32)i);
+      out->multiplicities.push_back(slot->count.load(std::memory_order_relaxed));
+    }
+  }
+
+  size_t n_unique = out->key_indices.size();
+  out->hashes.resize(n_unique);
+  out->op_codes.resize(n_unique);
+#pragma omp parallel for schedule(static)
+  for (size_t u = 0; u < n_unique; u++)
+  {
+    out->hashes[u] = in_hashes->at(out->key_indices[u]);
+    out->op_codes[u] = op_codes != nullptr ? op_codes->at(out->key_indices[u]) : 0u;
+  }
+}
@@ -0,0 +1,24 @@
+#ifndef COMBINE_H
+#define COMBINE_H
+#include "types.h"
+#include "numa.h"
+#include "openssl/sha.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// one entry per distinct (key, op code) pair, in order of first occurrence.
+// hashes and op_codes are gathered so they can be routed directly.
+struct CombinedKeys
+{
+  local_vector<u32> key_indices;
+  local_vector<u32> multiplicities;
+  local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> hashes;
+  local_vector<size_t> op_codes;
+};
+
+void combine_keys(std::vector<std::vector<u32>> *in_vecs,
+                  local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
+                  const local_vector<size_t> *op_codes, CombinedKeys *out);
+
+#endif // COMBINE_H
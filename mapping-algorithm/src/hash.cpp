@@ -1,5 +1,6 @@
 #include "hash.h"
 #include "types.h"
+#include "numa.h"
 #include "openssl/sha.h"
 #include <sstream>
 #include <iomanip>
@@ -47,42 +48,52 @@ void sha256_hash_veci(std::vector<u32> *in_vec, unsigned char *out_hash)
 };
 
 void vectors_to_hashes(std::vector<std::vector<u32>> *in_vecs,
-                       std::vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *out_hashes)
+                       local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *out_hashes)
 {
+  // first touch of the digest pages happens in the loop below, so they land
+  // on the same node as the thread that owns each static chunk
   out_hashes->resize(in_vecs->size());
-#pragma omp parallel for
+#pragma omp parallel for schedule(static)
   for (size_t i = 0; i < in_vecs->size(); i++)
   {
     sha256_hash_veci(&in_vecs->at(i), out_hashes->at(i).data());
   }
 }
 
-std::vector<u32> hashes_to_machine(std::vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
-                                   const size_t n_reducers, const std::vector<long double> *partition_bounds,
-                                   const std::vector<size_t> *hardware_codes,
-                                   u32 (*map)(unsigned char *, void *))
+// packs the arguments every map function expects and routes a single digest
+u32 route_hash(unsigned char *hash, const size_t n_reducers, const std::vector<long double> *partition_bounds,
+               const size_t *hardware_code, u32 (*map)(unsigned char *, void *))
 {
-  std::vector<u32> out_reducer_indices(in_hashes->size());
+  size_t args[3] = {n_reducers, (size_t)partition_bounds, (size_t)hardware_code};
+  return map(hash, (void *)&args);
+}
+
+local_vector<u32> hashes_to_machine(local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
+                                     const size_t n_reducers, const std::vector<long double> *partition_bounds,
+                                     const local_vector<size_t> *hardware_codes,
+                                     u32 (*map)(unsigned char *, void *))
+{
+  local_vector<u32> out_reducer_indices(in_hashes->size());
 
-  #pragma omp parallel for
+#pragma omp parallel for schedule(static)
   for (size_t i = 0; i < in_hashes->size(); i++)
   {
-    size_t args[3] = {n_reducers, (size_t)partition_bounds,
-                      // skips the dereference if hardware_codes is a nullptr
-                      hardware_codes != nullptr ? (size_t)&hardware_codes->at(i) : (size_t)nullptr};
-
-    out_reducer_indices[i] = map((unsigned char *)&in_hashes->at(i), (void *)&args);
+    // skips the dereference if hardware_codes is a nullptr
+    const size_t *hardware_code = hardware_codes != nullptr ? &hardware_codes->at(i) : nullptr;
+    out_reducer_indices[i] = route_hash(in_hashes->at(i).data(), n_reducers, partition_bounds,
+                                        hardware_code, map);
   }
   return out_reducer_indices;
 }
 
-u32 compare_veci(std::vector<u32> *in_vec1, std::vector<u32> *in_vec2)
+// returns 1 if in_vec1 orders before in_vec2, -1 if after and 0 if they are equal
+int compare_veci(std::vector<u32> *in_vec1, std::vector<u32> *in_vec2)
 {
   if (in_vec1->size() < in_vec2->size())
   {
     return 1;
   }
-  else if (in_vec1->size() < in_vec2->size())
+  else if (in_vec1->size() > in_vec2->size())
   {
     return -1;
   }
@@ -98,6 +109,5 @@ u32 compare_veci(std::vector<u32> *in_vec1, std::vector<u32> *in_vec2)
       return -1;
     }
   }
-  // if they are exactly equal, return 1
-  return 1;
+  return 0;
 }
@@ -1,7 +1,9 @@
 #ifndef HASH_H
 #define HASH_H
 #include "types.h"
+#include "numa.h"
 #include <vector>
+#include <array>
 #include "openssl/sha.h"
 #include <string>
 
@@ -16,12 +18,14 @@ std::string hash_to_string(unsigned char *hash, u32 len);
 // template <typename T> void sha256_hash_vector(std::vector<T> &v, unsigned char* hash_out);
 void sha256_hash_str(const std::string &s_input, unsigned char *hash_out);
 void sha256_hash_veci(std::vector<u32> *in_vec, unsigned char *out_hash);
-std::vector<u32> hashes_to_machine(std::vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
-                                   const size_t n_reducers, const std::vector<long double> *partition_bounds,
-                                   const std::vector<size_t> *hardware_codes,
-                                   u32 (*map)(unsigned char *, void *));
-u32 compare_veci(std::vector<u32> *in_vec1, std::vector<u32> *in_vec2);
+u32 route_hash(unsigned char *hash, const size_t n_reducers, const std::vector<long double> *partition_bounds,
+               const size_t *hardware_code, u32 (*map)(unsigned char *, void *));
+local_vector<u32> hashes_to_machine(local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
+                                     const size_t n_reducers, const std::vector<long double> *partition_bounds,
+                                     const local_vector<size_t> *hardware_codes,
+                                     u32 (*map)(unsigned char *, void *));
+int compare_veci(std::vector<u32> *in_vec1, std::vector<u32> *in_vec2);
 void vectors_to_hashes(std::vector<std::vector<u32>> *in_vecs,
-                       std::vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *out_hashes);
+                       local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *out_hashes);
 
 #endif // HASH_H
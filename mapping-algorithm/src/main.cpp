@@ -4,46 +4,48 @@
 #include <array>
 #include <chrono>
 #include <string.h>
+#include <omp.h>
 
 #include "hash.h"
 #include "types.h"
 #include "map.h"
 #include "model.h"
 #include "utils.h"
+#include "shuffle.h"
+#include "numa.h"
+#include "remap.h"
+#include "partition.h"
+#include "combine.h"
+#include "workload.h"
+#include "pipeline.h"
 #define BENCH_SIZE 65536 * 4
 #define BENCH_ITERS 100
+#define SHUFFLE_MAPPERS 4
+#define SHUFFLE_QUEUE_CAPACITY 1024
+#define NUMA_ITERS 10
+#define REMAP_ITERS 10
+#define PARTITION_ITERS 10
+#define SHUFFLE_ZIPF_ALPHA 1.2
+#define PIPELINE_EPOCHS 16
+#define PIPELINE_EPOCH_SIZE 65536
 
-void benchmark_timings(u32 (*map)(unsigned char *, void *), std::string file_path)
+void benchmark_timings(u32 (*map)(unsigned char *, void *),
+                       local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *hashes,
+                       std::string file_path)
 {
   size_t n_reducers = 16;
 
-  std::vector<std::vector<u32>> data_vecs(BENCH_SIZE);
-  for (u32 i = 0; i < BENCH_SIZE; i++)
-  {
-    data_vecs[i].resize(16);
-    for (u32 j = 0; j < 16; j++)
-    {
-      data_vecs[i][j] = u32(rand());
-    }
-  }
-
   std::vector<long double> partition_bounds = initial_partitions(n_reducers);
 
-  std::vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> hashes;
-  vectors_to_hashes(&data_vecs, &hashes);
+  local_vector<size_t> hardware_codes;
+  generate_op_codes(&hardware_codes, hashes->size(), nullptr, DEFAULT_SEED, 0);
 
-  std::vector<size_t> hardware_codes(BENCH_SIZE);
-  for (size_t i = 0; i < hardware_codes.size(); i++)
-  {
-    hardware_codes[i] = rand() % 4;
-  }
-
-  std::vector<u32> machines;
+  local_vector<u32> machines;
 
   auto start = std::chrono::high_resolution_clock::now();
 
   for (size_t iter = 0; iter < BENCH_ITERS; iter++)
-    machines = hashes_to_machine(&hashes, n_reducers, &partition_bounds,
+    machines = hashes_to_machine(hashes, n_reducers, &partition_bounds,
                                  &hardware_codes, map);
 
   auto end = std::chrono::high_resolution_clock::now();
@@ -52,7 +54,7 @@ void benchmark_timings(u32 (*map)(unsigned char *, void *), std::string file_pat
             << " ms" << std::endl;
 
   std::vector<long double> weights = initial_weights(n_reducers);
-  std::vector<long double> runtimes = model_machines(n_reducers, machines, hardware_codes);
+  std::vector<long double> runtimes = model_machines(n_reducers, &machines, &hardware_codes);
 
   long double prev_max_time = -1l;
   for (size_t i = 0; i < runtimes.size(); i++)
@@ -66,15 +68,14 @@ void benchmark_timings(u32 (*map)(unsigned char *, void *), std::string file_pat
     update_partitions(&partition_bounds, &weights, &runtimes);
   }
 
-  for (size_t i = 0; i < hardware_codes.size(); i++)
-  {
-    hardware_codes[i] = rand() % 4;
-  }
+  generate_op_codes(&hardware_codes, hashes->size(), nullptr, DEFAULT_SEED, 1);
 
-  machines = hashes_to_machine(&hashes, n_reducers, &partition_bounds,
+  machines = hashes_to_machine(hashes, n_reducers, &partition_bounds,
                                &hardware_codes, map);
-  runtimes = model_machines(n_reducers, machines, hardware_codes);
-  serialize_mappings(machines, file_path);
+  runtimes = model_machines(n_reducers, &machines, &hardware_codes);
+  local_vector<u32> origins;
+  generate_origins(&origins, hashes->size(), MAPPING_MAPPERS, MAPPING_ZIPF_ALPHA, DEFAULT_SEED);
+  serialize_mappings(machines, file_path, &hardware_codes, nullptr, &origins);
 
   long double max_time = -1l;
   for (size_t i = 0; i < runtimes.size(); i++)
@@ -86,13 +87,330 @@ void benchmark_timings(u32 (*map)(unsigned char *, void *), std::string file_pat
   std::cout << "Previous Iteration Time: " << prev_max_time << " ms" << std::endl;
 }
 
+void benchmark_shuffle(u32 (*map)(unsigned char *, void *), std::vector<std::vector<u32>> *data_vecs,
+                       const local_vector<size_t> *hardware_codes, const local_vector<u32> *origins,
+                       int pin_mode)
+{
+  size_t n_reducers = 16;
+
+  std::vector<long double> partition_bounds = initial_partitions(n_reducers);
+
+  ShuffleStats stats = run_shuffle(data_vecs, hardware_codes, origins, SHUFFLE_MAPPERS, n_reducers,
+                                   &partition_bounds, map, SHUFFLE_QUEUE_CAPACITY, pin_mode);
+
+  std::cout << "Shuffle Timing: " << stats.seconds * 1000.0 << " ms" << std::endl;
+  std::cout << "Shuffle Throughput: " << stats.records / stats.seconds / 1e6 << " Mrecords/s" << std::endl;
+  std::cout << "Reducer\tRecords\tMaxDepth\tMeanDepth\tStalls" << std::endl;
+  for (size_t i = 0; i < n_reducers; i++)
+  {
+    std::cout << i << "\t" << stats.reducer_records[i] << "\t" << stats.max_depth[i] << "\t"
+              << stats.mean_depth[i] << "\t" << stats.stalls[i] << std::endl;
+  }
+}
+
+// numa_aware first-touches the inputs in parallel, otherwise they are
+// initialized serially. threads are bound as set up by init_pinning
+void benchmark_numa(bool numa_aware)
+{
+  size_t n_reducers = 16;
+  std::vector<long double> partition_bounds = initial_partitions(n_reducers);
+  size_t max_threads = omp_get_num_procs();
+
+  std::vector<size_t> thread_counts;
+  for (size_t t = 1; t < max_threads; t *= 2)
+    thread_counts.push_back(t);
+  thread_counts.push_back(max_threads);
+
+  for (size_t n_threads : thread_counts)
+  {
+    omp_set_num_threads(n_threads);
+
+    // serial generation leaves every page on the main thread's node, parallel
+    // generation first-touches each chunk from the thread that maps it
+    std::vector<std::vector<u32>> data_vecs;
+    local_vector<size_t> hardware_codes;
+    generate_keys(&data_vecs, BENCH_SIZE, 16, DEFAULT_SEED, 0, numa_aware);
+    generate_op_codes(&hardware_codes, BENCH_SIZE, nullptr, DEFAULT_SEED, 0, numa_aware);
+
+    local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> hashes;
+    if (!numa_aware)
+    {
+      // what a value-initialized std::vector would do
+      hashes.assign(BENCH_SIZE, std::array<unsigned char, SHA256_DIGEST_LENGTH>{});
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    vectors_to_hashes(&data_vecs, &hashes);
+    auto mid = std::chrono::high_resolution_clock::now();
+    local_vector<u32> machines;
+    for (size_t iter = 0; iter < NUMA_ITERS; iter++)
+    {
+      machines = hashes_to_machine(&hashes, n_reducers, &partition_bounds,
+                                   &hardware_codes, partition_hw_strict);
+      model_machines(n_reducers, &machines, &hardware_codes);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double hash_s = std::chrono::duration<double>(mid - start).count();
+    double route_s = std::chrono::duration<double>(end - mid).count() / NUMA_ITERS;
+    // digest + op code read and reducer index written by routing, both read again by the model
+    double route_bytes = BENCH_SIZE * (2.0 * (SHA256_DIGEST_LENGTH + sizeof(size_t)) + 2.0 * sizeof(u32));
+    double key_bytes = BENCH_SIZE * (16.0 * sizeof(u32) + SHA256_DIGEST_LENGTH);
+
+    // sockets the threads can run on: the ones they are bound to, or all of them
+    size_t sockets = omp_sockets_covered(n_threads);
+    std::cout << n_threads << "\t" << sockets << "/" << socket_count() << "\t"
+              << hash_s * 1000.0 << "\t" << key_bytes / hash_s / 1e9 << "\t"
+              << route_s * 1000.0 << "\t" << route_bytes / route_s / 1e9 << std::endl;
+  }
+}
+
+void benchmark_remap(u32 (*map)(unsigned char *, void *))
+{
+  size_t n_reducers = 16;
+
+  std::vector<std::vector<u32>> data_vecs;
+  local_vector<size_t> hardware_codes;
+  generate_keys(&data_vecs, BENCH_SIZE, 16, DEFAULT_SEED);
+  generate_op_codes(&hardware_codes, BENCH_SIZE, nullptr, DEFAULT_SEED);
+
+  local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> hashes;
+  vectors_to_hashes(&data_vecs, &hashes);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  RemapIndex index(&hashes, &hardware_codes, map);
+  auto end = std::chrono::high_resolution_clock::now();
+  std::cout << "Index Build: "
+            << std::chrono::duration<double, std::milli>(end - start).count() << " ms" << std::endl;
+
+  std::cout << "Shift\tMoved\tIncremental(ms)\tFull(ms)\tMismatches" << std::endl;
+  for (long double shift : {1e-5l, 1e-4l, 1e-3l, 1e-2l})
+  {
+    std::vector<long double> old_bounds = initial_partitions(n_reducers);
+    std::vector<long double> new_bounds = old_bounds;
+    // nudge interior bounds alternately up and down
+    for (size_t i = 1; i < n_reducers; i++)
+      new_bounds[i] += (i % 2 == 0) ? shift : -shift;
+
+    local_vector<u32> machines = hashes_to_machine(&hashes, n_reducers, &old_bounds,
+                                                   &hardware_codes, map);
+    std::vector<RemapDelta> deltas;
+    double incremental_ms = 0.0;
+    for (size_t iter = 0; iter < REMAP_ITERS; iter++)
+    {
+      start = std::chrono::high_resolution_clock::now();
+      deltas = index.remap(&old_bounds, &new_bounds, nullptr);
+      end = std::chrono::high_resolution_clock::now();
+      incremental_ms += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    for (auto &d : deltas)
+      machines[d.key_idx] = d.new_reducer;
+
+    local_vector<u32> full;
+    start = std::chrono::high_resolution_clock::now();
+    for (size_t iter = 0; iter < REMAP_ITERS; iter++)
+      full = hashes_to_machine(&hashes, n_reducers, &new_bounds, &hardware_codes, map);
+    end = std::chrono::high_resolution_clock::now();
+    double full_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < full.size(); i++)
+      mismatches += machines[i] != full[i];
+
+    std::cout << (double)shift << "\t" << deltas.size() << "\t" << incremental_ms / REMAP_ITERS << "\t"
+              << full_ms / REMAP_ITERS << "\t" << mismatches << std::endl;
+  }
+}
+
+void benchmark_partition(size_t n_reducers)
+{
+  // uniformly spread reducer indices
+  local_vector<u32> machines;
+  local_vector<size_t> hardware_codes;
+  generate_origins(&machines, BENCH_SIZE, n_reducers, 0.0, DEFAULT_SEED);
+  generate_op_codes(&hardware_codes, BENCH_SIZE, nullptr, DEFAULT_SEED);
+
+  PartitionedOutput naive, scattered;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (size_t iter = 0; iter < PARTITION_ITERS; iter++)
+    partition_by_reducer_naive(&machines, &hardware_codes, n_reducers, &naive);
+  auto mid = std::chrono::high_resolution_clock::now();
+  for (size_t iter = 0; iter < PARTITION_ITERS; iter++)
+    partition_by_reducer(&machines, &hardware_codes, n_reducers, &scattered);
+  auto end = std::chrono::high_resolution_clock::now();
+
+  size_t mismatches = naive.offsets != scattered.offsets;
+  for (size_t i = 0; i < BENCH_SIZE; i++)
+    mismatches += naive.records[i].key_idx != scattered.records[i].key_idx;
+
+  std::cout << n_reducers << "\t"
+            << std::chrono::duration<double, std::milli>(mid - start).count() / PARTITION_ITERS << "\t"
+            << std::chrono::duration<double, std::milli>(end - mid).count() / PARTITION_ITERS << "\t"
+            << mismatches << std::endl;
+}
+
+// keys are drawn from a pool of pool_size (key, op code) pairs so repeats are common.
+// unique instead takes each of the first BENCH_SIZE pool keys exactly once.
+void benchmark_combine(size_t pool_size, bool unique, std::string file_path)
+{
+  size_t n_reducers = 16;
+  std::vector<std::vector<u32>> pool;
+  local_vector<size_t> pool_codes;
+  generate_keys(&pool, pool_size, 16, DEFAULT_SEED);
+  generate_op_codes(&pool_codes, pool_size, nullptr, DEFAULT_SEED);
+
+  local_vector<u32> picks(BENCH_SIZE);
+  if (unique)
+  {
+    for (size_t i = 0; i < BENCH_SIZE; i++)
+      picks[i] = (u32)i;
+  }
+  else
+  {
+    // uniform picks from the pool, with replacement. a different seed than
+    // the key origins below so picks and origins are independent
+    generate_origins(&picks, BENCH_SIZE, pool_size, 0.0, DEFAULT_SEED + 1);
+  }
+  std::vector<std::vector<u32>> data_vecs(BENCH_SIZE);
+  local_vector<size_t> hardware_codes(BENCH_SIZE);
+  for (size_t i = 0; i < BENCH_SIZE; i++)
+  {
+    data_vecs[i] = pool[picks[i]];
+    hardware_codes[i] = pool_codes[picks[i]];
+  }
+
+  std::vector<long double> partition_bounds = initial_partitions(n_reducers);
+  local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> hashes;
+  vectors_to_hashes(&data_vecs, &hashes);
+
+  auto start = std::chrono::high_resolution_clock::now();
+  local_vector<u32> machines = hashes_to_machine(&hashes, n_reducers, &partition_bounds,
+                                                 &hardware_codes, partition_hw_strict);
+  auto mid = std::chrono::high_resolution_clock::now();
+  CombinedKeys combined;
+  combine_keys(&data_vecs, &hashes, &hardware_codes, &combined);
+  auto combine_end = std::chrono::high_resolution_clock::now();
+  local_vector<u32> combined_machines = hashes_to_machine(&combined.hashes, n_reducers, &partition_bounds,
+                                                          &combined.op_codes, partition_hw_strict);
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::vector<long double> runtimes = model_machines(n_reducers, &machines, &hardware_codes);
+  std::vector<long double> combined_runtimes = model_machines(n_reducers, &combined_machines,
+                                                              &combined.op_codes, &combined.multiplicities);
+  // a combined record ships from the mapper of its first occurrence
+  local_vector<u32> origins, combined_origins(combined.key_indices.size());
+  generate_origins(&origins, BENCH_SIZE, MAPPING_MAPPERS, MAPPING_ZIPF_ALPHA, DEFAULT_SEED);
+  for (size_t i = 0; i < combined.key_indices.size(); i++)
+    combined_origins[i] = origins[combined.key_indices[i]];
+  serialize_mappings(combined_machines, file_path, &combined.op_codes, &combined.multiplicities,
+                     &combined_origins);
+
+  double combine_ms = std::chrono::duration<double, std::milli>(combine_end - mid).count();
+  // every routed key is one distinct (key, op code) pair that was actually drawn
+  std::cout << pool_size << "\t" << machines.size() << "\t" << combined_machines.size() << "\t"
+            << 100.0 * (1.0 - double(combined_machines.size()) / machines.size()) << "\t"
+            << combine_ms * 1e6 / (BENCH_SIZE) << "\t"
+            << std::chrono::duration<double, std::milli>(mid - start).count() << "\t"
+            << combine_ms + std::chrono::duration<double, std::milli>(end - combine_end).count() << "\t"
+            << (max_val(runtimes) == max_val(combined_runtimes) ? "yes" : "no") << std::endl;
+}
+
+void report_epochs(std::string label, PipelineStats *stats)
+{
+  long double mean_runtime = 0.0l;
+  for (auto t : stats->max_runtimes)
+    mean_runtime += t / stats->max_runtimes.size();
+  std::cout << label << "\t" << stats->epochs / stats->seconds << "\t" << mean_runtime << std::endl;
+}
+
 int main(int argc, char *argv[])
 {
+  // COLBRA_PIN=pack|spread binds the worker threads of every mode, see init_pinning
+  int pin_mode = pin_mode_from_env();
+  init_pinning(pin_mode, argv);
+
+  if (argc > 1 && strcmp(argv[1], "pipeline") == 0)
+  {
+    std::cout << "Mode\tEpochs/s\tMean Accelerator Runtime (ms)" << std::endl;
+    PipelineStats sequential = run_epochs_sequential(PIPELINE_EPOCHS, PIPELINE_EPOCH_SIZE, 16, partition_bounded_map,
+                                                     DEFAULT_SEED, "sequential_mappings.txt");
+    report_epochs("Sequential", &sequential);
+    PipelineStats pipelined = run_epochs_pipelined(PIPELINE_EPOCHS, PIPELINE_EPOCH_SIZE, 16, partition_bounded_map,
+                                                   DEFAULT_SEED, "pipelined_mappings.txt");
+    report_epochs("Pipelined", &pipelined);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "combine") == 0)
+  {
+    std::cout << "Pool\tOps\tDistinct\tReduction(%)\tCombine(ns/key)\tRoute(ms)\tCombine+Route(ms)\tSameModel" << std::endl;
+    benchmark_combine(BENCH_SIZE, true, "combined_unique_mappings.txt");
+    benchmark_combine(BENCH_SIZE / 4, false, "combined_pool_quarter_mappings.txt");
+    benchmark_combine(BENCH_SIZE / 16, false, "combined_pool_sixteenth_mappings.txt");
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "partition") == 0)
+  {
+    std::cout << "Reducers\tAppend(ms)\tScatter(ms)\tMismatches" << std::endl;
+    for (size_t n_reducers : {16, 256, 4096})
+      benchmark_partition(n_reducers);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "remap") == 0)
+  {
+    std::cout << "----------------Partition bounded remap----------------" << std::endl;
+    benchmark_remap(partition_bounded_map);
+    std::cout << "----------------Strict hardware-aware remap----------------" << std::endl;
+    benchmark_remap(partition_hw_strict);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "numa") == 0)
+  {
+    // binding is fixed for the whole process, rerun with COLBRA_PIN=pack or spread to compare
+    const char *placement[] = {"unpinned", "packed onto one socket", "spread across sockets"};
+    std::cout << "Threads\tSockets\tHash(ms)\tHash(GB/s)\tRoute(ms)\tRoute(GB/s)" << std::endl;
+    if (pin_mode == PIN_NONE)
+    {
+      std::cout << "----------------Serial init, unpinned----------------" << std::endl;
+      benchmark_numa(false);
+    }
+    std::cout << "----------------Parallel first-touch, " << placement[pin_mode] << "----------------" << std::endl;
+    benchmark_numa(true);
+    return 0;
+  }
+
+  if (argc > 1 && strcmp(argv[1], "shuffle") == 0)
+  {
+    std::vector<std::vector<u32>> data_vecs;
+    local_vector<size_t> hardware_codes;
+    local_vector<u32> origins;
+    generate_keys(&data_vecs, BENCH_SIZE, 16, DEFAULT_SEED);
+    generate_op_codes(&hardware_codes, BENCH_SIZE, nullptr, DEFAULT_SEED);
+    generate_origins(&origins, BENCH_SIZE, SHUFFLE_MAPPERS, SHUFFLE_ZIPF_ALPHA, DEFAULT_SEED);
+
+    std::cout << "----------------Naive mapping shuffle----------------" << std::endl;
+    benchmark_shuffle(naive_map, &data_vecs, &hardware_codes, &origins, pin_mode);
+    std::cout << "----------------Partition bounded shuffle----------------" << std::endl;
+    benchmark_shuffle(partition_bounded_map, &data_vecs, &hardware_codes, &origins, pin_mode);
+    std::cout << "----------------Strict hardware-aware shuffle----------------" << std::endl;
+    benchmark_shuffle(partition_hw_strict, &data_vecs, &hardware_codes, &origins, pin_mode);
+    return 0;
+  }
+
+  // generated and hashed once, shared by every strategy
+  std::vector<std::vector<u32>> data_vecs;
+  generate_keys(&data_vecs, BENCH_SIZE, 16, DEFAULT_SEED);
+  local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> hashes;
+  vectors_to_hashes(&data_vecs, &hashes);
+
   std::cout << "----------------Naive mapping----------------" << std::endl;
-  benchmark_timings(naive_map, "naive_mappings.txt");
+  benchmark_timings(naive_map, &hashes, "naive_mappings.txt");
   std::cout << "----------------Partition bounded mappings----------------" << std::endl;
-  benchmark_timings(partition_bounded_map, "partition_bounded_mappings.txt");
+  benchmark_timings(partition_bounded_map, &hashes, "partition_bounded_mappings.txt");
   std::cout << "----------------Strict hardware-aware mapping----------------" << std::endl;
-  benchmark_timings(partition_hw_strict, "partition_hw_strict_mappings.txt");
+  benchmark_timings(partition_hw_strict, &hashes, "partition_hw_strict_mappings.txt");
   return 0;
 }
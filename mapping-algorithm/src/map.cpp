@@ -12,9 +12,34 @@ u32 naive_map(unsigned char *h, void *args)
 
 u32 partition_bounded_map(unsigned char *h, void *args)
 {
-  u32 n_reducers = (u32)((size_t *)args)[0];
   std::vector<long double> *partition_bounds = ((std::vector<long double> **)args)[1];
+  return partition_index(hash_position(h, 0u, partition_bounded_map), partition_bounds);
+}
+
+// position of a hash in [0, 1] as seen by the partition-bounded maps,
+// which only compare this value against the partition bounds
+long double hash_position(unsigned char *h, size_t operation_code, u32 (*map)(unsigned char *, void *))
+{
   long double val = static_cast<long double>(*(reinterpret_cast<u64 *>(h))) / UINT64_MAX;
+  if (map != partition_hw_strict)
+  {
+    return val;
+  }
+
+  long double hardware_factor = 2.0f;
+  long double hardware_offset = 0.5f;
+  if (operation_code < 2u)
+  {
+    hardware_factor = 2.0f;
+    hardware_offset = 0.0f;
+  }
+  return val / hardware_factor + hardware_offset;
+}
+
+// index of the partition containing val, equal to the number of
+// bounds (past the first) that lie strictly below val
+u32 partition_index(long double val, const std::vector<long double> *partition_bounds)
+{
   size_t i = 0;
 
   if (val < partition_bounds->at(1))
@@ -96,34 +121,8 @@ void update_partitions(std::vector<long double> *partition_bounds,
 
 u32 partition_hw_strict(unsigned char *h, void *args)
 {
-  u32 n_reducers = (u32)((size_t *)args)[0];
   std::vector<long double> *partition_bounds = (std::vector<long double> *)((size_t *)args)[1];
   size_t operation_code = *((size_t *)((size_t *)args)[2]);
 
-  long double hardware_factor = 2.0f;
-  long double hardware_offset = 0.5f;
-  if (operation_code < 2u)
-  {
-    hardware_factor = 2.0f;
-    hardware_offset = 0.0f;
-  }
-
-  long double val = (static_cast<long double>(*(reinterpret_cast<size_t *>(h))) / UINT64_MAX) / hardware_factor + hardware_offset;
-  size_t i = 0;
-
-  if (val < partition_bounds->at(1))
-  {
-    return 0u;
-  }
-  // linear scan because n_reducers is small (in simulation)
-  while (val > partition_bounds->at(i) && i < partition_bounds->size() - 1)
-  {
-    i++;
-  }
-  if (val <= partition_bounds->at(i))
-  {
-    i--;
-  }
-
-  return i;
+  return partition_index(hash_position(h, operation_code, partition_hw_strict), partition_bounds);
 }
@@ -2,16 +2,18 @@
 #define MAP_H
 #include "types.h"
 #include <vector>
+#include <cstddef>
 
 u32 naive_map(unsigned char *h, void *args);
 u32 partition_bounded_map(unsigned char *h, void *args);
 u32 partition_hw_strict(unsigned char *h, void *args);
+long double hash_position(unsigned char *h, size_t operation_code, u32 (*map)(unsigned char *, void *));
+u32 partition_index(long double val, const std::vector<long double> *partition_bounds);
 std::vector<long double> initial_partitions(size_t n_reducers);
 std::vector<long double> initial_weights(size_t n_reducers);
 
 void update_partitions(std::vector<long double> *partition_bounds,
                        std::vector<long double> *weights,
                        std::vector<long double> *runtimes);
-static std::vector<double> zipf_cdf(u32 m, double alpha);
 
 #endif // MAP_H
@@ -1,18 +1,34 @@
 #include "model.h"
 #include "types.h"
+#include "numa.h"
 
 #include <vector>
 #include <cstddef>
 #include <iostream>
 #include <math.h>
 
-std::vector<long double> model_machines(size_t n_reducers, std::vector<u32> machines, std::vector<size_t> op_codes)
+// multiplicities, if given, is the number of combined copies behind each mapping
+std::vector<long double> model_machines(size_t n_reducers, const local_vector<u32> *machines,
+                                        const local_vector<size_t> *op_codes,
+                                        const local_vector<u32> *multiplicities)
 {
   std::vector<long double> runtimes(n_reducers, 0.0l);
   std::vector<std::vector<size_t>> machine_ops(n_reducers, std::vector<size_t>(4));
-  for (size_t i = 0; i < machines.size(); i++)
+
+  // each thread counts its own static chunk of the mapping, which is the same
+  // chunk it wrote in hashes_to_machine, then merges into the shared table
+#pragma omp parallel
   {
-    machine_ops[machines[i]][op_codes[i]]++;
+    std::vector<size_t> local_ops(n_reducers * 4, 0);
+#pragma omp for schedule(static) nowait
+    for (size_t i = 0; i < machines->size(); i++)
+    {
+      local_ops[(*machines)[i] * 4 + (*op_codes)[i]] += multiplicities != nullptr ? (*multiplicities)[i] : 1u;
+    }
+#pragma omp critical
+    for (size_t i = 0; i < n_reducers; i++)
+      for (size_t j = 0; j < 4; j++)
+        machine_ops[i][j] += local_ops[i * 4 + j];
   }
 
 #pragma omp parallel for
@@ -28,10 +44,10 @@ std::vector<long double> model_machines(size_t n_reducers, std::vector<u32> mach
       model = bank_level_est;
     }
     long double time = 0.0l;
-    time += model(machine_ops[i][OP_VEC_ADD]*16, OP_VEC_ADD);
-    time += model(machine_ops[i][OP_VEC_DOT]*16, OP_VEC_DOT);
-    time += model(machine_ops[i][OP_MAT_MAT]*16, OP_MAT_MAT);
-    time += model(machine_ops[i][OP_MAT_VEC]*16, OP_MAT_VEC);
+    time += model(machine_ops[i][OP_VEC_ADD] * OP_ELEMENTS, OP_VEC_ADD);
+    time += model(machine_ops[i][OP_VEC_DOT] * OP_ELEMENTS, OP_VEC_DOT);
+    time += model(machine_ops[i][OP_MAT_MAT] * OP_ELEMENTS, OP_MAT_MAT);
+    time += model(machine_ops[i][OP_MAT_VEC] * OP_ELEMENTS, OP_MAT_VEC);
     runtimes[i] = time;
   }
 
@@ -91,3 +107,21 @@ long double cpu_est(size_t size, size_t operation)
     return -1u;
   }
 }
+
+// bytes a mapper ships to the reducer for one op, i.e. both operands as
+// u32 elements: two vectors, a matrix and a vector, or two matrices
+size_t op_payload_bytes(size_t operation)
+{
+  switch (operation)
+  {
+  case OP_VEC_ADD:
+  case OP_VEC_DOT:
+    return 2 * OP_ELEMENTS * sizeof(u32);
+  case OP_MAT_VEC:
+    return (OP_ELEMENTS * OP_ELEMENTS + OP_ELEMENTS) * sizeof(u32);
+  case OP_MAT_MAT:
+    return 2 * OP_ELEMENTS * OP_ELEMENTS * sizeof(u32);
+  default:
+    return OP_ELEMENTS * sizeof(u32);
+  }
+}
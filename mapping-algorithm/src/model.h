@@ -2,6 +2,7 @@
 #define MODEL_H
 
 #include "types.h"
+#include "numa.h"
 #include <cstddef>
 #include <vector>
 
@@ -10,9 +11,17 @@
 #define OP_MAT_MAT 2u
 #define OP_MAT_VEC 3u
 
+// elements per op operand (vector length, matrix side), matching the key length.
+// vector ops work on 16-vectors and matrix ops on 16x16 matrices, the shape
+// model_machines, op_payload_bytes and the shuffle kernels all assume
+#define OP_ELEMENTS 16u
+
 long double bank_level_est(size_t size, size_t operation);
 long double gpu_est(size_t size, size_t operation);
 long double cpu_est(size_t size, size_t operation);
-std::vector<long double> model_machines(size_t n_reducers, std::vector<u32> machines, std::vector<size_t> op_codes);
+size_t op_payload_bytes(size_t operation);
+std::vector<long double> model_machines(size_t n_reducers, const local_vector<u32> *machines,
+                                        const local_vector<size_t> *op_codes,
+                                        const local_vector<u32> *multiplicities = nullptr);
 
 #endif // MODEL_H
@@ -0,0 +1,179 @@
+#include "numa.h"
+#include <omp.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+// set in the environment of a re-executed colbra so it never re-executes twice
+#define PIN_EXEC_ENV "COLBRA_PIN_EXEC"
+
+static int read_topology(int cpu, const std::string &field)
+{
+  std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + field);
+  int val = 0;
+  if (file.is_open())
+    file >> val;
+  return val;
+}
+
+// online cpus ordered by (socket, core, cpu) so that neighbouring threads
+// share a socket and static chunks stay on one memory node. computed once,
+// before any thread is pinned, since pinning narrows the affinity mask.
+// when the omp runtime binds threads it has already narrowed the initial
+// thread's mask, so the cpus are taken from its place list instead.
+std::vector<int> cpus_by_socket()
+{
+  static const std::vector<int> cpus = []()
+  {
+    std::vector<std::tuple<int, int, int>> topo;
+    if (omp_get_proc_bind() != omp_proc_bind_false && omp_get_num_places() > 0)
+    {
+      for (int place = 0; place < omp_get_num_places(); place++)
+      {
+        std::vector<int> ids(omp_get_place_num_procs(place));
+        omp_get_place_proc_ids(place, ids.data());
+        for (int i : ids)
+          topo.emplace_back(read_topology(i, "physical_package_id"), read_topology(i, "core_id"), i);
+      }
+    }
+#ifdef __linux__
+    else
+    {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      if (sched_getaffinity(0, sizeof(set), &set) == 0)
+      {
+        for (int i = 0; i < CPU_SETSIZE; i++)
+          if (CPU_ISSET(i, &set))
+            topo.emplace_back(read_topology(i, "physical_package_id"), read_topology(i, "core_id"), i);
+      }
+    }
+#else
+    else
+    {
+      for (int i = 0; i < omp_get_num_procs(); i++)
+        topo.emplace_back(0, i, i);
+    }
+#endif
+    std::sort(topo.begin(), topo.end());
+    std::vector<int> out;
+    for (auto &t : topo)
+      out.push_back(std::get<2>(t));
+    return out;
+  }();
+  return cpus;
+}
+
+size_t socket_count()
+{
+  return sockets_covered(cpus_by_socket());
+}
+
+// number of distinct sockets the given cpus belong to
+size_t sockets_covered(const std::vector<int> &cpus)
+{
+  std::vector<int> sockets;
+  for (int cpu : cpus)
+    sockets.push_back(read_topology(cpu, "physical_package_id"));
+  std::sort(sockets.begin(), sockets.end());
+  return std::max<size_t>(1, std::unique(sockets.begin(), sockets.end()) - sockets.begin());
+}
+
+// cpu each of n_threads threads of a persistent pool is bound to. PIN_PACK
+// fills the socket-ordered cpu list from the front, so threads stay on one
+// socket until it is full. PIN_SPREAD spaces threads evenly over the list,
+// so they cover every socket as soon as there are enough of them.
+// PIN_NONE returns every cpu, since unpinned threads may run anywhere.
+std::vector<int> pinned_cpus(size_t n_threads, int mode)
+{
+  std::vector<int> cpus = cpus_by_socket();
+  if (mode == PIN_NONE || cpus.empty())
+    return cpus;
+
+  std::vector<int> out(n_threads);
+  for (size_t tid = 0; tid < n_threads; tid++)
+  {
+    size_t idx = mode == PIN_PACK ? tid : tid * cpus.size() / n_threads;
+    out[tid] = cpus[idx % cpus.size()];
+  }
+  return out;
+}
+
+// PIN_NONE unless COLBRA_PIN is "pack" or "spread"
+int pin_mode_from_env()
+{
+  const char *val = getenv(PIN_ENV);
+  if (val == nullptr)
+    return PIN_NONE;
+  if (strcmp(val, "pack") == 0)
+    return PIN_PACK;
+  if (strcmp(val, "spread") == 0)
+    return PIN_SPREAD;
+  if (strcmp(val, "none") != 0 && val[0] != '\0')
+    std::cerr << PIN_ENV << "=" << val << " not recognized, threads stay unpinned" << std::endl;
+  return PIN_NONE;
+}
+
+// omp threads are bound by the runtime itself: PIN_PACK is proc_bind(close)
+// and PIN_SPREAD is proc_bind(spread), both over OMP_PLACES=cores. the runtime
+// reads those variables once at startup, so if they don't already give the
+// requested binding colbra sets them and re-executes itself. must be called
+// first thing in main. linux only, elsewhere threads stay unpinned.
+void init_pinning(int mode, char *argv[])
+{
+  if (mode == PIN_NONE)
+    return;
+  omp_proc_bind_t want = mode == PIN_PACK ? omp_proc_bind_close : omp_proc_bind_spread;
+  if (omp_get_proc_bind() == want || getenv(PIN_EXEC_ENV) != nullptr)
+    return;
+#ifdef __linux__
+  setenv("OMP_PLACES", "cores", 1);
+  setenv("OMP_PROC_BIND", mode == PIN_PACK ? "close" : "spread", 1);
+  setenv(PIN_EXEC_ENV, "1", 1);
+  execv("/proc/self/exe", argv);
+#endif
+  std::cerr << "could not apply " << PIN_ENV << ", threads stay unpinned" << std::endl;
+}
+
+// sockets spanned by the places a team of n_threads omp threads is bound to,
+// or every socket if the runtime doesn't bind threads
+size_t omp_sockets_covered(size_t n_threads)
+{
+  if (omp_get_proc_bind() == omp_proc_bind_false || omp_get_num_places() == 0)
+    return socket_count();
+
+  std::vector<int> cpus;
+#pragma omp parallel num_threads(n_threads)
+  {
+    int place = omp_get_place_num();
+    std::vector<int> ids(place >= 0 ? omp_get_place_num_procs(place) : 0);
+    if (!ids.empty())
+      omp_get_place_proc_ids(place, ids.data());
+#pragma omp critical
+    cpus.insert(cpus.end(), ids.begin(), ids.end());
+  }
+  return cpus.empty() ? socket_count() : sockets_covered(cpus);
+}
+
+// binds the calling thread to one cpu. for threads that are not part of an
+// omp team, each one pins itself before it starts its work. linux only.
+void pin_current_thread(int cpu)
+{
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  sched_setaffinity(0, sizeof(set), &set);
+#else
+  (void)cpu;
+#endif
+}
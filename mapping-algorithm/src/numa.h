@@ -0,0 +1,59 @@
+#ifndef NUMA_H
+#define NUMA_H
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// allocator that default-initializes elements instead of value-initializing them,
+// so resizing a buffer of trivial types never writes to its pages. each page is
+// then placed on the NUMA node of the thread that first writes to it.
+// based on: https://stackoverflow.com/questions/21028299
+template <typename T>
+struct first_touch_allocator : std::allocator<T>
+{
+  template <typename U>
+  struct rebind
+  {
+    using other = first_touch_allocator<U>;
+  };
+
+  first_touch_allocator() noexcept = default;
+  template <typename U>
+  first_touch_allocator(const first_touch_allocator<U> &) noexcept {}
+
+  template <typename U>
+  void construct(U *p) noexcept(std::is_nothrow_default_constructible<U>::value)
+  {
+    ::new ((void *)p) U;
+  }
+  template <typename U, typename... Args>
+  void construct(U *p, Args &&...args)
+  {
+    ::new ((void *)p) U(std::forward<Args>(args)...);
+  }
+};
+
+// buffers written by the map phase (digests, op codes, reducer indices)
+template <typename T>
+using local_vector = std::vector<T, first_touch_allocator<T>>;
+
+#define PIN_NONE 0
+#define PIN_PACK 1
+#define PIN_SPREAD 2
+
+// COLBRA_PIN=pack|spread selects how worker threads are placed on cpus
+#define PIN_ENV "COLBRA_PIN"
+
+std::vector<int> cpus_by_socket();
+size_t socket_count();
+size_t sockets_covered(const std::vector<int> &cpus);
+std::vector<int> pinned_cpus(size_t n_threads, int mode);
+int pin_mode_from_env();
+void init_pinning(int mode, char *argv[]);
+size_t omp_sockets_covered(size_t n_threads);
+void pin_current_thread(int cpu);
+
+#endif // NUMA_H
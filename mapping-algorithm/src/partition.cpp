@@ -0,0 +1,141 @@
+#include "partition.h"
+#include "model.h"
+#include "types.h"
+#include <omp.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// records buffered per reducer before being written out, 8 x 8 B fills one cache line
+#define WC_ENTRIES 8
+
+struct alignas(64) WriteCombineLine
+{
+  ShuffleRecord recs[WC_ENTRIES];
+};
+
+// records that fit before p reaches the next cache line boundary, a full line if it is on one
+static inline u32 line_room(const ShuffleRecord *p)
+{
+  return WC_ENTRIES - (u32)(((uintptr_t)p & 63) / sizeof(ShuffleRecord));
+}
+
+// write one full buffer to an aligned line, bypassing the cache where we can
+// since the scatter won't read it back
+static inline void flush_line(ShuffleRecord *dst, const WriteCombineLine &line)
+{
+#ifdef __SSE2__
+  const __m128i *src = (const __m128i *)line.recs;
+  __m128i *out = (__m128i *)dst;
+  for (u32 i = 0; i < sizeof(WriteCombineLine) / sizeof(__m128i); i++)
+    _mm_stream_si128(out + i, _mm_load_si128(src + i));
+#else
+  memcpy(dst, line.recs, sizeof(line.recs));
+#endif
+}
+
+// parallel two-pass counting sort. each thread histograms its static chunk,
+// a prefix sum in (reducer, thread) order gives every thread a private slice
+// of each reducer's range, and the scatter goes through per-reducer
+// write-combining buffers. each buffer first flushes the partial run up to its
+// slice's next cache line boundary, after that every flush is one full aligned line.
+void partition_by_reducer(const local_vector<u32> *machines, const local_vector<size_t> *op_codes,
+                          size_t n_reducers, PartitionedOutput *out)
+{
+  size_t n = machines->size();
+  size_t max_threads = omp_get_max_threads();
+  std::vector<size_t> cursors(max_threads * n_reducers, 0);
+  out->offsets.assign(n_reducers + 1, 0);
+  out->records.resize(n);
+
+#pragma omp parallel num_threads(max_threads)
+  {
+    size_t tid = omp_get_thread_num();
+    size_t n_threads = omp_get_num_threads();
+    size_t *cursor = &cursors[tid * n_reducers];
+
+#pragma omp for schedule(static)
+    for (size_t i = 0; i < n; i++)
+    {
+      cursor[(*machines)[i]]++;
+    }
+
+#pragma omp single
+    {
+      size_t running = 0;
+      for (size_t r = 0; r < n_reducers; r++)
+      {
+        out->offsets[r] = running;
+        for (size_t t = 0; t < n_threads; t++)
+        {
+          size_t count = cursors[t * n_reducers + r];
+          cursors[t * n_reducers + r] = running;
+          running += count;
+        }
+      }
+      out->offsets[n_reducers] = running;
+    }
+
+    std::vector<WriteCombineLine> lines(n_reducers);
+    std::vector<u32> fill(n_reducers, 0);
+    std::vector<u32> room(n_reducers);
+    ShuffleRecord *dst = out->records.data();
+    for (size_t r = 0; r < n_reducers; r++)
+      room[r] = line_room(dst + cursor[r]);
+
+    // same iteration count and thread count, so each thread gets the same chunk as above
+#pragma omp for schedule(static)
+    for (size_t i = 0; i < n; i++)
+    {
+      u32 r = (*machines)[i];
+      lines[r].recs[fill[r]++] = {(u32)i, op_codes != nullptr ? (u32)(*op_codes)[i] : OP_VEC_ADD};
+      if (fill[r] == room[r])
+      {
+        if (room[r] == WC_ENTRIES)
+          flush_line(dst + cursor[r], lines[r]);
+        else
+          memcpy(dst + cursor[r], lines[r].recs, fill[r] * sizeof(ShuffleRecord));
+        cursor[r] += fill[r];
+        fill[r] = 0;
+        room[r] = WC_ENTRIES;
+      }
+    }
+
+    for (size_t r = 0; r < n_reducers; r++)
+    {
+      if (fill[r] == 0)
+        continue;
+      memcpy(dst + cursor[r], lines[r].recs, fill[r] * sizeof(ShuffleRecord));
+      cursor[r] += fill[r];
+    }
+#ifdef __SSE2__
+    // streaming stores are weakly ordered, fence before the region's closing barrier
+    _mm_sfence();
+#endif
+  }
+}
+
+// per-key append into one growable bucket per reducer, then flattened
+void partition_by_reducer_naive(const local_vector<u32> *machines, const local_vector<size_t> *op_codes,
+                                size_t n_reducers, PartitionedOutput *out)
+{
+  std::vector<std::vector<ShuffleRecord>> buckets(n_reducers);
+  for (size_t i = 0; i < machines->size(); i++)
+  {
+    buckets[(*machines)[i]].push_back({(u32)i, op_codes != nullptr ? (u32)(*op_codes)[i] : OP_VEC_ADD});
+  }
+
+  out->offsets.assign(n_reducers + 1, 0);
+  out->records.resize(machines->size());
+  size_t running = 0;
+  for (size_t r = 0; r < n_reducers; r++)
+  {
+    out->offsets[r] = running;
+    memcpy(out->records.data() + running, buckets[r].data(), buckets[r].size() * sizeof(ShuffleRecord));
+    running += buckets[r].size();
+  }
+  out->offsets[n_reducers] = running;
+}
@@ -0,0 +1,22 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+#include "types.h"
+#include "numa.h"
+#include "shuffle.h"
+#include <cstddef>
+#include <vector>
+
+// keys grouped by destination reducer: the records for reducer r are
+// records[offsets[r]] .. records[offsets[r + 1] - 1], in key order
+struct PartitionedOutput
+{
+  std::vector<size_t> offsets;
+  local_vector<ShuffleRecord> records;
+};
+
+void partition_by_reducer(const local_vector<u32> *machines, const local_vector<size_t> *op_codes,
+                          size_t n_reducers, PartitionedOutput *out);
+void partition_by_reducer_naive(const local_vector<u32> *machines, const local_vector<size_t> *op_codes,
+                                size_t n_reducers, PartitionedOutput *out);
+
+#endif // PARTITION_H
@@ -0,0 +1,26 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include "types.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// epochs that may be in flight at once in the pipelined loop
+#define PIPELINE_DEPTH 3
+// epochs between a model run and the mapping that uses its partition bounds
+#define PIPELINE_BOUNDS_LAG 2
+
+struct PipelineStats
+{
+  size_t epochs;
+  double seconds;
+  // slowest modeled reducer per epoch
+  std::vector<long double> max_runtimes;
+};
+
+PipelineStats run_epochs_sequential(size_t n_epochs, size_t epoch_size, size_t n_reducers,
+                                    u32 (*map)(unsigned char *, void *), u64 seed, std::string file_path);
+PipelineStats run_epochs_pipelined(size_t n_epochs, size_t epoch_size, size_t n_reducers,
+                                   u32 (*map)(unsigned char *, void *), u64 seed, std::string file_path);
+
+#endif // PIPELINE_H
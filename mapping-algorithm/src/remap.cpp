@@ -0,0 +1,97 @@
+#include "remap.h"
+#include "map.h"
+#include "types.h"
+#include <algorithm>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+RemapIndex::RemapIndex(local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
+                       const local_vector<size_t> *hardware_codes,
+                       u32 (*map)(unsigned char *, void *))
+{
+  // the naive map ignores the partition bounds, so nothing ever moves
+  if (map == naive_map)
+  {
+    return;
+  }
+
+  std::vector<long double> unsorted(in_hashes->size());
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < in_hashes->size(); i++)
+  {
+    size_t op_code = hardware_codes != nullptr ? hardware_codes->at(i) : 0u;
+    unsorted[i] = hash_position(in_hashes->at(i).data(), op_code, map);
+  }
+
+  key_indices.resize(in_hashes->size());
+  std::iota(key_indices.begin(), key_indices.end(), 0u);
+  std::sort(key_indices.begin(), key_indices.end(), [&](u32 a, u32 b)
+            { return unsorted[a] < unsorted[b]; });
+
+  positions.resize(key_indices.size());
+  for (size_t i = 0; i < key_indices.size(); i++)
+  {
+    positions[i] = unsorted[key_indices[i]];
+  }
+}
+
+// a key at position p changes reducer only if some bound k has exactly one
+// of old[k], new[k] strictly below p, i.e. p lies in (min, max] of the two.
+// the union of those ranges is walked once, so cost scales with keys moved.
+std::vector<RemapDelta> RemapIndex::remap(const std::vector<long double> *old_bounds,
+                                          const std::vector<long double> *new_bounds,
+                                          local_vector<u32> *machines) const
+{
+  std::vector<RemapDelta> deltas;
+  if (positions.empty())
+  {
+    return deltas;
+  }
+
+  std::vector<std::pair<long double, long double>> shifted;
+  for (size_t k = 1; k < old_bounds->size(); k++)
+  {
+    long double lo = std::min(old_bounds->at(k), new_bounds->at(k));
+    long double hi = std::max(old_bounds->at(k), new_bounds->at(k));
+    if (lo == hi)
+    {
+      continue;
+    }
+    // bounds stay sorted, so ranges only need merging with their predecessor
+    if (!shifted.empty() && lo <= shifted.back().second)
+    {
+      shifted.back().second = std::max(shifted.back().second, hi);
+    }
+    else
+    {
+      shifted.push_back({lo, hi});
+    }
+  }
+
+  for (auto &range : shifted)
+  {
+    size_t begin = std::upper_bound(positions.begin(), positions.end(), range.first) - positions.begin();
+    size_t end = std::upper_bound(positions.begin(), positions.end(), range.second) - positions.begin();
+    for (size_t i = begin; i < end; i++)
+    {
+      u32 old_reducer = partition_index(positions[i], old_bounds);
+      u32 new_reducer = partition_index(positions[i], new_bounds);
+      if (old_reducer == new_reducer)
+      {
+        continue;
+      }
+      deltas.push_back({key_indices[i], old_reducer, new_reducer});
+      if (machines != nullptr)
+      {
+        (*machines)[key_indices[i]] = new_reducer;
+      }
+    }
+  }
+  return deltas;
+}
+
+size_t RemapIndex::size() const
+{
+  return positions.size();
+}
@@ -0,0 +1,41 @@
+#ifndef REMAP_H
+#define REMAP_H
+#include "types.h"
+#include "numa.h"
+#include "openssl/sha.h"
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// a key whose reducer changed after the partition bounds moved
+struct RemapDelta
+{
+  u32 key_idx;
+  u32 old_reducer;
+  u32 new_reducer;
+};
+
+// keys sorted by the position of their hash prefix, so that only the keys
+// lying between an old bound and its new value are revisited on a rebalance.
+// for partition_hw_strict a key's position also depends on its op code, so the
+// index is a snapshot of the op codes it was built with and must be rebuilt
+// whenever they change (e.g. after benchmark_timings redraws them). a stale
+// index returns wrong deltas without any error.
+class RemapIndex
+{
+public:
+  RemapIndex(local_vector<std::array<unsigned char, SHA256_DIGEST_LENGTH>> *in_hashes,
+             const local_vector<size_t> *hardware_codes,
+             u32 (*map)(unsigned char *, void *));
+  std::vector<RemapDelta> remap(const std::vector<long double> *old_bounds,
+                                const std::vector<long double> *new_bounds,
+                                local_vector<u32> *machines) const;
+  size_t size() const;
+
+private:
+  // sorted ascending, key_indices[i] is the key at positions[i]
+  std::vector<long double> positions;
+  std::vector<u32> key_indices;
+};
+
+#endif // REMAP_H
@@ -0,0 +1,95 @@
+#ifndef RNG_H
+#define RNG_H
+// header-only and free of colbra types so that mapreduce-sim.cc can include
+// it directly from the ns-3 scratch directory (see scripts/push.sh)
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// independent streams drawn from one seed
+#define STREAM_KEYS 0ull
+#define STREAM_OP_CODES 1ull
+#define STREAM_ORIGINS 2ull
+
+// SplitMix64 finalizer, from:
+//   https://prng.di.unimi.it/splitmix64.c
+inline uint64_t splitmix64(uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// counter-based: the n-th value of a stream depends only on (seed, stream, n),
+// so any thread can generate any element and the output is the same on every
+// platform and thread count
+inline uint64_t counter_rand(uint64_t seed, uint64_t stream, uint64_t counter)
+{
+  uint64_t key = splitmix64(seed ^ splitmix64(stream));
+  return splitmix64(key + 0x9e3779b97f4a7c15ull * counter);
+}
+
+// uniform double in [0, 1) from the top 53 bits
+inline double counter_unit(uint64_t seed, uint64_t stream, uint64_t counter)
+{
+  return static_cast<double>(counter_rand(seed, stream, counter) >> 11) * 0x1.0p-53;
+}
+
+// cdf of a discrete distribution from unnormalized weights
+inline std::vector<double> weights_cdf(const std::vector<double> &weights)
+{
+  std::vector<double> cdf(weights.size());
+  if (weights.empty())
+  {
+    return cdf;
+  }
+
+  double sum = 0.0;
+  for (double w : weights)
+    sum += w;
+
+  double acc = 0.0;
+  for (size_t k = 0; k < weights.size(); k++)
+  {
+    acc += weights[k] / sum;
+    cdf[k] = acc;
+  }
+
+  cdf[weights.size() - 1] = 1.0;
+  return cdf;
+}
+
+// alpha == 0 gives a uniform distribution
+inline std::vector<double> zipf_cdf(uint32_t m, double alpha)
+{
+  std::vector<double> weights(m);
+  for (uint32_t k = 0; k < m; ++k)
+  {
+    weights[k] = 1.0 / std::pow(static_cast<double>(k + 1), alpha);
+  }
+  return weights_cdf(weights);
+}
+
+// first index whose cdf value is >= u
+inline uint32_t cdf_pick(const std::vector<double> &cdf, double u)
+{
+  uint32_t low = 0;
+  uint32_t high = static_cast<uint32_t>(cdf.size() - 1);
+  while (low < high)
+  {
+    uint32_t mid = (low + high) / 2u;
+    if (u <= cdf[mid])
+    {
+      high = mid;
+    }
+    else
+    {
+      low = mid + 1;
+    }
+  }
+
+  return low;
+}
+
+#endif // RNG_H
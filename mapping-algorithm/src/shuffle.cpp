@@ -0,0 +1,271 @@
+#include "shuffle.h"
+#include "hash.h"
+#include "model.h"
+#include "partition.h"
+#include "types.h"
+#include "openssl/sha.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define KERNEL_DIM OP_ELEMENTS
+#define KERNEL_LEN (KERNEL_DIM * KERNEL_DIM)
+
+MPSCQueue::MPSCQueue(size_t capacity)
+{
+  // round up to a power of two so positions can be masked instead of modded
+  size_t cap = 2;
+  while (cap < capacity)
+    cap <<= 1;
+  cells.reset(new Cell[cap]);
+  for (size_t i = 0; i < cap; i++)
+    cells[i].seq.store(i, std::memory_order_relaxed);
+  mask = cap - 1;
+  enqueue_pos.store(0, std::memory_order_relaxed);
+  dequeue_pos.store(0, std::memory_order_relaxed);
+}
+
+bool MPSCQueue::try_push(const ShuffleRecord &rec)
+{
+  size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    Cell *cell = &cells[pos & mask];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0)
+    {
+      if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+      {
+        cell->rec = rec;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    }
+    else if (diff < 0)
+    {
+      // full
+      return false;
+    }
+    else
+    {
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+// single consumer, so the dequeue position needs no CAS
+bool MPSCQueue::try_pop(ShuffleRecord *rec)
+{
+  size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+  Cell *cell = &cells[pos & mask];
+  size_t seq = cell->seq.load(std::memory_order_acquire);
+  if ((intptr_t)seq - (intptr_t)(pos + 1) < 0)
+    return false;
+
+  *rec = cell->rec;
+  cell->seq.store(pos + mask + 1, std::memory_order_release);
+  dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+  return true;
+}
+
+size_t MPSCQueue::depth() const
+{
+  size_t head = enqueue_pos.load(std::memory_order_relaxed);
+  size_t tail = dequeue_pos.load(std::memory_order_relaxed);
+  return head > tail ? head - tail : 0;
+}
+
+size_t MPSCQueue::capacity() const
+{
+  return mask + 1;
+}
+
+// reducer kernels work on OP_ELEMENTS-vectors and OP_ELEMENTS x OP_ELEMENTS
+// matrices, the operand shape the model and the sim payloads are sized for.
+// a key is one vector, for matrix ops it is the first row of a circulant
+// matrix (row r is the key rotated by r). results fold into a per-reducer
+// accumulator matrix whose first row doubles as the vector accumulator.
+static u64 run_kernel(u32 op_code, const u32 *key, u32 *acc)
+{
+  u64 out = 0;
+  switch (op_code)
+  {
+  case OP_VEC_ADD:
+    for (u32 i = 0; i < KERNEL_DIM; i++)
+      acc[i] += key[i];
+    out = acc[0];
+    break;
+  case OP_VEC_DOT:
+    for (u32 i = 0; i < KERNEL_DIM; i++)
+      out += (u64)acc[i] * key[i];
+    break;
+  case OP_MAT_VEC:
+  {
+    u32 y[KERNEL_DIM] = {0};
+    for (u32 r = 0; r < KERNEL_DIM; r++)
+      for (u32 c = 0; c < KERNEL_DIM; c++)
+        y[r] += key[(r + c) % KERNEL_DIM] * acc[c];
+    for (u32 r = 0; r < KERNEL_DIM; r++)
+    {
+      acc[r] = y[r];
+      out += y[r];
+    }
+    break;
+  }
+  case OP_MAT_MAT:
+  {
+    u32 c_tile[KERNEL_LEN] = {0};
+    for (u32 r = 0; r < KERNEL_DIM; r++)
+      for (u32 k = 0; k < KERNEL_DIM; k++)
+      {
+        u32 a = key[(r + k) % KERNEL_DIM];
+        for (u32 c = 0; c < KERNEL_DIM; c++)
+          c_tile[r * KERNEL_DIM + c] += a * acc[k * KERNEL_DIM + c];
+      }
+    for (u32 i = 0; i < KERNEL_LEN; i++)
+    {
+      // keep the accumulator from collapsing to zero
+      acc[i] = c_tile[i] | 1u;
+      out += c_tile[i];
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return out;
+}
+
+// origins, if given, holds the mapper each key starts on (see generate_origins),
+// otherwise every mapper takes one contiguous chunk of the keys. with pin_mode
+// set, reducers then mappers take consecutive cpus from pinned_cpus and each
+// thread pins itself before it starts.
+ShuffleStats run_shuffle(std::vector<std::vector<u32>> *in_vecs, const local_vector<size_t> *op_codes,
+                         const local_vector<u32> *origins, size_t n_mappers, size_t n_reducers,
+                         const std::vector<long double> *partition_bounds,
+                         u32 (*map)(unsigned char *, void *), size_t queue_capacity,
+                         int pin_mode)
+{
+  std::vector<std::unique_ptr<MPSCQueue>> queues(n_reducers);
+  for (size_t i = 0; i < n_reducers; i++)
+    queues[i].reset(new MPSCQueue(queue_capacity));
+
+  ShuffleStats stats;
+  stats.records = in_vecs->size();
+  stats.reducer_records.assign(n_reducers, 0);
+  stats.max_depth.assign(n_reducers, 0);
+  stats.mean_depth.assign(n_reducers, 0.0);
+  stats.checksums.assign(n_reducers, 0);
+  std::vector<std::vector<size_t>> mapper_stalls(n_mappers, std::vector<size_t>(n_reducers, 0));
+
+  // group keys by their origin mapper up front, this is input placement rather than shuffle work
+  PartitionedOutput by_mapper;
+  if (origins != nullptr)
+  {
+    partition_by_reducer(origins, op_codes, n_mappers, &by_mapper);
+  }
+  size_t chunk = (in_vecs->size() + n_mappers - 1) / n_mappers;
+
+  std::vector<int> cpus = pinned_cpus(n_reducers + n_mappers, pin_mode);
+  std::atomic<size_t> mappers_done(0);
+  std::vector<std::thread> threads;
+  threads.reserve(n_mappers + n_reducers);
+
+  auto start = std::chrono::high_resolution_clock::now();
+
+  for (size_t r = 0; r < n_reducers; r++)
+  {
+    threads.emplace_back([&, r]()
+                         {
+      if (pin_mode != PIN_NONE)
+        pin_current_thread(cpus[r]);
+      MPSCQueue *q = queues[r].get();
+      u32 acc[KERNEL_LEN];
+      for (u32 i = 0; i < KERNEL_LEN; i++)
+        acc[i] = 1u;
+      size_t received = 0, depth_sum = 0, depth_samples = 0, max_depth = 0;
+      u64 checksum = 0;
+      ShuffleRecord rec;
+      for (;;)
+      {
+        // sampled only when there is a record to take, so idle spins don't
+        // drag the mean toward zero. includes the record being popped.
+        size_t depth = q->depth();
+        if (q->try_pop(&rec))
+        {
+          depth_sum += depth;
+          depth_samples++;
+          if (depth > max_depth)
+            max_depth = depth;
+          checksum += run_kernel(rec.op_code, in_vecs->at(rec.key_idx).data(), acc);
+          received++;
+          continue;
+        }
+        // only stop once every mapper is finished and the queue has drained
+        if (mappers_done.load(std::memory_order_acquire) == n_mappers)
+        {
+          depth = q->depth();
+          if (!q->try_pop(&rec))
+            break;
+          depth_sum += depth;
+          depth_samples++;
+          if (depth > max_depth)
+            max_depth = depth;
+          checksum += run_kernel(rec.op_code, in_vecs->at(rec.key_idx).data(), acc);
+          received++;
+          continue;
+        }
+        std::this_thread::yield();
+      }
+      stats.reducer_records[r] = received;
+      stats.max_depth[r] = max_depth;
+      stats.mean_depth[r] = depth_samples != 0 ? double(depth_sum) / depth_samples : 0.0;
+      stats.checksums[r] = checksum; });
+  }
+
+  for (size_t m = 0; m < n_mappers; m++)
+  {
+    threads.emplace_back([&, m]()
+                         {
+      if (pin_mode != PIN_NONE)
+        pin_current_thread(cpus[n_reducers + m]);
+      size_t begin = origins != nullptr ? by_mapper.offsets[m] : std::min(m * chunk, in_vecs->size());
+      size_t end = origins != nullptr ? by_mapper.offsets[m + 1] : std::min(begin + chunk, in_vecs->size());
+      std::array<unsigned char, SHA256_DIGEST_LENGTH> digest;
+      for (size_t k = begin; k < end; k++)
+      {
+        size_t i = origins != nullptr ? by_mapper.records[k].key_idx : k;
+        // same hash + route path as vectors_to_hashes/hashes_to_machine
+        sha256_hash_veci(&in_vecs->at(i), digest.data());
+        u32 reducer = route_hash(digest.data(), n_reducers, partition_bounds,
+                                 op_codes != nullptr ? &op_codes->at(i) : nullptr, map);
+
+        ShuffleRecord rec = {(u32)i, op_codes != nullptr ? (u32)op_codes->at(i) : OP_VEC_ADD};
+        // backpressure: spin politely until the reducer makes room,
+        // counting one stall per push that found the queue full
+        if (!queues[reducer]->try_push(rec))
+        {
+          mapper_stalls[m][reducer]++;
+          while (!queues[reducer]->try_push(rec))
+            std::this_thread::yield();
+        }
+      }
+      mappers_done.fetch_add(1, std::memory_order_release); });
+  }
+
+  for (auto &t : threads)
+    t.join();
+
+  auto end = std::chrono::high_resolution_clock::now();
+  stats.seconds = std::chrono::duration<double>(end - start).count();
+
+  stats.stalls.assign(n_reducers, 0);
+  for (size_t m = 0; m < n_mappers; m++)
+    for (size_t r = 0; r < n_reducers; r++)
+      stats.stalls[r] += mapper_stalls[m][r];
+
+  return stats;
+}
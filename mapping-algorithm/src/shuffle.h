@@ -0,0 +1,61 @@
+#ifndef SHUFFLE_H
+#define SHUFFLE_H
+#include "types.h"
+#include "numa.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// a single routed op as it travels from a mapper to a reducer
+struct ShuffleRecord
+{
+  u32 key_idx;
+  u32 op_code;
+};
+
+// bounded lock-free multi-producer/single-consumer ring, adapted from:
+//   https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// each reducer owns one and every mapper pushes into it
+class MPSCQueue
+{
+public:
+  explicit MPSCQueue(size_t capacity);
+  bool try_push(const ShuffleRecord &rec);
+  bool try_pop(ShuffleRecord *rec);
+  size_t depth() const;
+  size_t capacity() const;
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> seq;
+    ShuffleRecord rec;
+  };
+  std::unique_ptr<Cell[]> cells;
+  size_t mask;
+  alignas(64) std::atomic<size_t> enqueue_pos;
+  alignas(64) std::atomic<size_t> dequeue_pos;
+};
+
+struct ShuffleStats
+{
+  double seconds;
+  size_t records;
+  std::vector<size_t> reducer_records;
+  // queue depth seen by the reducer at each successful pop
+  std::vector<size_t> max_depth;
+  std::vector<double> mean_depth;
+  // number of pushes that found this reducer's queue full
+  std::vector<size_t> stalls;
+  // folded kernel results, keeps the reducer work from being optimized out
+  std::vector<u64> checksums;
+};
+
+ShuffleStats run_shuffle(std::vector<std::vector<u32>> *in_vecs, const local_vector<size_t> *op_codes,
+                         const local_vector<u32> *origins, size_t n_mappers, size_t n_reducers,
+                         const std::vector<long double> *partition_bounds,
+                         u32 (*map)(unsigned char *, void *), size_t queue_capacity,
+                         int pin_mode = PIN_NONE);
+
+#endif // SHUFFLE_H
@@ -1,5 +1,6 @@
 #include "utils.h"
 #include "types.h"
+#include "model.h"
 #include <vector>
 #include <fstream>
 
@@ -25,13 +26,28 @@ std::vector<u32> read_mappings(std::string file_path)
   }
 }
 
-void serialize_mappings(std::vector<u32> machines, std::string file_path)
+// one record per line. with op codes each line is tab separated:
+//   reducer  op_code  payload_bytes  multiplicity  [origin]
+// multiplicity is 1 unless the keys were combined. origin is the mapper the
+// op starts on, mapreduce-sim.cc sends it from there. without op codes a line
+// is just the reducer index. read_mappings only parses the leading reducer index.
+void serialize_mappings(const local_vector<u32> &machines, std::string file_path,
+                        const local_vector<size_t> *op_codes,
+                        const local_vector<u32> *multiplicities,
+                        const local_vector<u32> *origins)
 {
   std::ofstream file;
   file.open(file_path);
   for (u32 i = 0; i < machines.size(); i++)
   {
     file << machines[i];
+    if (op_codes != nullptr)
+    {
+      file << "\t" << (*op_codes)[i] << "\t" << op_payload_bytes((*op_codes)[i]) << "\t"
+           << (multiplicities != nullptr ? (*multiplicities)[i] : 1u);
+      if (origins != nullptr)
+        file << "\t" << (*origins)[i];
+    }
     if (i != machines.size() - 1)
       file << "\n";
   }
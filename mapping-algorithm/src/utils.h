@@ -1,11 +1,15 @@
 #ifndef UTILS_H
 #define UTILS_H
 #include "types.h"
+#include "numa.h"
 #include <vector>
 #include <string>
 
 std::vector<u32> read_mappings(std::string file_path);
-void serialize_mappings(std::vector<u32> machines, std::string file_path);
+void serialize_mappings(const local_vector<u32> &machines, std::string file_path,
+                        const local_vector<size_t> *op_codes = nullptr,
+                        const local_vector<u32> *multiplicities = nullptr,
+                        const local_vector<u32> *origins = nullptr);
 long double max_val(std::vector<long double> vec);
 
 #endif //UTILS_H
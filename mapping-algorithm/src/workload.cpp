@@ -0,0 +1,66 @@
+#include "workload.h"
+#include "rng.h"
+#include "types.h"
+#include <vector>
+
+// every element is a pure function of (seed, stream, index), so the loops
+// below give identical output serially, in parallel and across platforms.
+// parallel fills use the map phase's static schedule for first touch.
+
+// the index-th key of the stream, for callers that schedule their own loops
+void generate_key(u32 *key, size_t key_len, u64 seed, u64 index)
+{
+  for (size_t j = 0; j < key_len; j++)
+  {
+    key[j] = u32(counter_rand(seed, STREAM_KEYS, index * key_len + j));
+  }
+}
+
+size_t generate_op_code(const std::vector<double> *cdf, u64 seed, u64 index)
+{
+  return cdf_pick(*cdf, counter_unit(seed, STREAM_OP_CODES, index));
+}
+
+u32 generate_origin(const std::vector<double> *cdf, u64 seed, u64 index)
+{
+  return cdf_pick(*cdf, counter_unit(seed, STREAM_ORIGINS, index));
+}
+
+// each epoch is a separate counter range so epochs can be drawn independently
+void generate_keys(std::vector<std::vector<u32>> *keys, size_t n_keys, size_t key_len, u64 seed,
+                   u64 epoch, bool parallel)
+{
+  keys->resize(n_keys);
+#pragma omp parallel for schedule(static) if (parallel)
+  for (size_t i = 0; i < n_keys; i++)
+  {
+    keys->at(i).resize(key_len);
+    generate_key(keys->at(i).data(), key_len, seed, epoch * n_keys + i);
+  }
+}
+
+// op_mix holds relative weights per op code, nullptr draws all four uniformly
+void generate_op_codes(local_vector<size_t> *op_codes, size_t n_keys, const std::vector<double> *op_mix,
+                       u64 seed, u64 epoch, bool parallel)
+{
+  std::vector<double> cdf = op_mix != nullptr ? weights_cdf(*op_mix) : zipf_cdf(4, 0.0);
+  op_codes->resize(n_keys);
+#pragma omp parallel for schedule(static) if (parallel)
+  for (size_t i = 0; i < n_keys; i++)
+  {
+    (*op_codes)[i] = generate_op_code(&cdf, seed, epoch * n_keys + i);
+  }
+}
+
+// origin mapper of each op, counted like the keys so origin i goes with key i
+void generate_origins(local_vector<u32> *origins, size_t n_keys, u32 n_mappers, double zipf_alpha,
+                      u64 seed, u64 epoch)
+{
+  std::vector<double> cdf = zipf_cdf(n_mappers, zipf_alpha < 0.0 ? 0.0 : zipf_alpha);
+  origins->resize(n_keys);
+#pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n_keys; i++)
+  {
+    (*origins)[i] = generate_origin(&cdf, seed, epoch * n_keys + i);
+  }
+}
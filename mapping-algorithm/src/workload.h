@@ -0,0 +1,23 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include "types.h"
+#include "numa.h"
+#include <cstddef>
+#include <vector>
+
+#define DEFAULT_SEED 42ull
+// origin mappers written into mapping files, drawn for mapreduce-sim.cc's default mapper count
+#define MAPPING_MAPPERS 16u
+#define MAPPING_ZIPF_ALPHA 1.2
+
+void generate_key(u32 *key, size_t key_len, u64 seed, u64 index);
+size_t generate_op_code(const std::vector<double> *cdf, u64 seed, u64 index);
+u32 generate_origin(const std::vector<double> *cdf, u64 seed, u64 index);
+void generate_keys(std::vector<std::vector<u32>> *keys, size_t n_keys, size_t key_len, u64 seed,
+                   u64 epoch = 0, bool parallel = true);
+void generate_op_codes(local_vector<size_t> *op_codes, size_t n_keys, const std::vector<double> *op_mix,
+                       u64 seed, u64 epoch = 0, bool parallel = true);
+void generate_origins(local_vector<u32> *origins, size_t n_keys, u32 n_mappers, double zipf_alpha,
+                      u64 seed, u64 epoch = 0);
+
+#endif // WORKLOAD_H
@@ -8,24 +8,57 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <map>
+#include <sstream>
+
+// shared with colbra, copied next to this file by scripts/push.sh
+#include "rng.h"
 
 #define u32 uint32_t
 #define u16 uint16_t
 
 using namespace ns3;
 
-std::vector<u32> read_mappings(std::string file_path)
+// no origin in the mapping file, one is drawn for the record instead
+#define NO_ORIGIN UINT32_MAX
+
+// one line of a colbra mapping file:
+//   reducer [op_code payload_bytes multiplicity [origin]]
+// plain files with only the reducer index ship default_payload bytes per op
+struct MappingRecord
+{
+  u32 reducer;
+  u32 op_code;
+  u32 payload_bytes;
+  u32 multiplicity;
+  u32 origin;
+};
+
+std::vector<MappingRecord> read_mappings(std::string file_path, u32 default_payload)
 {
   std::string line;
   std::ifstream file(file_path);
-  std::vector<u32> vec;
+  std::vector<MappingRecord> vec;
   if (file.is_open())
   {
     while (std::getline(file, line))
     {
       if (line.empty())
         continue;
-      vec.push_back(static_cast<u32>(std::stoul(line)));
+      std::istringstream fields(line);
+      MappingRecord rec = {0, 0, default_payload, 1, NO_ORIGIN};
+      fields >> rec.reducer;
+      if (!(fields >> rec.op_code >> rec.payload_bytes >> rec.multiplicity))
+      {
+        rec.op_code = 0;
+        rec.payload_bytes = default_payload;
+        rec.multiplicity = 1;
+      }
+      else if (!(fields >> rec.origin))
+      {
+        rec.origin = NO_ORIGIN;
+      }
+      vec.push_back(rec);
     }
     file.close();
     return vec;
@@ -37,6 +70,8 @@ std::vector<u32> read_mappings(std::string file_path)
 }
 
 static std::vector<std::vector<Time>> g_delays_by_reducer;
+static std::vector<uint64_t> g_bytes_by_reducer;
+static std::vector<Time> g_last_rx_by_reducer;
 
 static void RxTracer(u32 reducer_idx, Ptr<const Packet> p, const Address &from, const Address &local)
 {
@@ -49,53 +84,8 @@ static void RxTracer(u32 reducer_idx, Ptr<const Packet> p, const Address &from,
   Time delay = rx_time - tx_time;
 
   g_delays_by_reducer[reducer_idx].push_back(delay);
-}
-
-static std::vector<double> zipf_cdf(u32 m, double alpha)
-{
-  std::vector<double> cdf(m);
-  if (m == 0)
-  {
-    return cdf;
-  }
-
-  double sum = 0.0f;
-  for (u32 k = 0; k < m; ++k)
-  {
-    double w = 1.0f / std::pow(static_cast<double>(k + 1), alpha);
-    cdf[k] = w;
-    sum += w;
-  }
-
-  double acc = 0.0f;
-  for (u32 k = 0; k < m; k++)
-  {
-    acc += cdf[k] / sum;
-    cdf[k] = acc;
-  }
-
-  cdf[m - 1] = 1.0f;
-  return cdf;
-}
-
-static u32 zipf_pick(const std::vector<double> &cdf, double u)
-{
-  u32 low = 0;
-  u32 high = static_cast<u32>(cdf.size() - 1);
-  while (low < high)
-  {
-    u32 mid = (low + high) / 2u;
-    if (u <= cdf[mid])
-    {
-      high = mid;
-    }
-    else
-    {
-      low = mid + 1;
-    }
-  }
-
-  return low;
+  g_bytes_by_reducer[reducer_idx] += p->GetSize();
+  g_last_rx_by_reducer[reducer_idx] = std::max(g_last_rx_by_reducer[reducer_idx], rx_time);
 }
 
 int main(int argc, char *argv[])
@@ -105,7 +95,9 @@ int main(int argc, char *argv[])
   u32 ops_per_mapper = 1000;
   double zipf_alpha = 1.2;
   u32 packet_size = 512;
+  u32 mtu = 1500;
   std::string link_data_rate = "100.0Gbps";
+  std::string mapper_rate = "1Gbps";
   std::string link_delay = "100us";
   double stop_time = 10.0f;
   u32 seed = 42;
@@ -116,8 +108,10 @@ int main(int argc, char *argv[])
   cmd.AddValue("n_reducers", "number of reducer nodes", n_reducers);
   cmd.AddValue("ops_per_mapper", "operations per mapper node", ops_per_mapper);
   cmd.AddValue("zipf_alpha", "alpha for zipf function", zipf_alpha);
-  cmd.AddValue("packet_size", "packet size", packet_size);
+  cmd.AddValue("packet_size", "payload per op for mapping files without op sizes", packet_size);
+  cmd.AddValue("mtu", "link mtu, payloads are fragmented into packets of at most this size", mtu);
   cmd.AddValue("link_data_rate", "data transfer rate for links", link_data_rate);
+  cmd.AddValue("mapper_rate", "send rate of each mapper, split across its flows by bytes", mapper_rate);
   cmd.AddValue("link_delay", "csma delay (uniform sending tax)", link_delay);
   cmd.AddValue("stop_time", "stop time (in seconds)", stop_time);
   cmd.AddValue("seed", "seed for random operations", seed);
@@ -125,12 +119,16 @@ int main(int argc, char *argv[])
   cmd.Parse(argc, argv);
 
   NS_ABORT_IF(n_mappers == 0 || n_reducers == 0 || mapping_file.empty());
+  // a fragment has to fit the ipv4 + udp headers and the udp client's SeqTsHeader
+  NS_ABORT_IF(mtu <= 28 + 12 || mtu > 65535);
+  uint64_t mapper_bps = DataRate(mapper_rate).GetBitRate();
+  NS_ABORT_IF(mapper_bps == 0);
   g_delays_by_reducer.assign(n_reducers, std::vector<Time>{});
-  std::vector<u32> mappings = read_mappings(mapping_file);
+  g_bytes_by_reducer.assign(n_reducers, 0);
+  g_last_rx_by_reducer.assign(n_reducers, Seconds(0));
+  std::vector<MappingRecord> mappings = read_mappings(mapping_file, packet_size);
 
   RngSeedManager::SetSeed(seed);
-  Ptr<UniformRandomVariable> uv = CreateObject<UniformRandomVariable>();
-  uv->SetStream(1);
 
   u32 total_nodes = n_mappers + n_reducers;
   NodeContainer nodes;
@@ -140,6 +138,8 @@ int main(int argc, char *argv[])
   csma.SetChannelAttribute("DataRate", StringValue(link_data_rate));
   csma.SetChannelAttribute("Delay", TimeValue(Time(link_delay)));
   csma.SetQueue("ns3::DropTailQueue", "MaxSize", StringValue("1000p"));
+  // match the fragment size below so ip doesn't split the datagrams again
+  csma.SetDeviceAttribute("Mtu", UintegerValue(mtu));
 
   NetDeviceContainer devices = csma.Install(nodes);
 
@@ -172,51 +172,99 @@ int main(int argc, char *argv[])
     zipf_alpha = 0.0f;
   }
 
-  std::vector<double> cdf = zipf_cdf(n_reducers, zipf_alpha);
+  std::vector<double> cdf = zipf_cdf(n_mappers, zipf_alpha);
   std::vector<u32> planned_reducer_ops(n_reducers, 0);
-  std::vector<std::vector<u32>> op_mappings(n_mappers, std::vector<u32>(n_reducers, 0));
+  std::vector<uint64_t> planned_reducer_bytes(n_reducers, 0);
+  // transfers[mapper][reducer][payload_bytes] = number of transfers of that size
+  std::vector<std::vector<std::map<u32, u32>>> transfers(n_mappers, std::vector<std::map<u32, u32>>(n_reducers));
 
   for (u32 i = 0; i < mappings.size(); ++i)
   {
-    double u = uv->GetValue();
-    // pick a random origin mapper
-    u32 mapper_idx = zipf_pick(cdf, u);
-    op_mappings[mapper_idx][mappings[i]] += 1;
-    planned_reducer_ops[mappings[i]] += 1;
+    const MappingRecord &rec = mappings[i];
+    // colbra writes the origin mapper it drew for the op, older files get a random one
+    u32 mapper_idx = rec.origin;
+    if (mapper_idx == NO_ORIGIN)
+    {
+      mapper_idx = cdf_pick(cdf, counter_unit(seed, STREAM_ORIGINS, i));
+    }
+    NS_ABORT_MSG_IF(mapper_idx >= n_mappers, "mapping file origin " << mapper_idx << " needs --n_mappers > " << mapper_idx);
+    NS_ABORT_MSG_IF(rec.reducer >= n_reducers, "mapping file reducer " << rec.reducer << " needs --n_reducers > " << rec.reducer);
+    // a combined record ships its operands once for all of its copies
+    transfers[mapper_idx][rec.reducer][rec.payload_bytes] += 1;
+    planned_reducer_ops[rec.reducer] += rec.multiplicity;
+    planned_reducer_bytes[rec.reducer] += rec.payload_bytes;
   }
 
+  // largest udp payload that fits in one mtu (ipv4 + udp headers), and the
+  // smallest the udp client can send since it carries a SeqTsHeader
+  u32 max_fragment = mtu - 28;
+  u32 min_fragment = 12;
+
+  // fragments[mapper][reducer][fragment_size] = number of packets of that size.
+  // each transfer is split into full mtu-sized fragments plus one remainder
+  std::vector<std::vector<std::map<u32, u32>>> fragments(n_mappers, std::vector<std::map<u32, u32>>(n_reducers));
   for (u32 i = 0; i < n_mappers; i++)
   {
-    Ptr<Node> mapper = nodes.Get(i);
-    double start = 1.0 + 0.01 * static_cast<double>(i);
-    double end = stop_time;
-    double span = std::max(0.1, end - start);
+    for (u32 j = 0; j < n_reducers; j++)
+    {
+      for (auto &t : transfers[i][j])
+      {
+        u32 payload = t.first;
+        u32 count = t.second;
+        if (payload / max_fragment > 0)
+        {
+          fragments[i][j][max_fragment] += count * (payload / max_fragment);
+        }
+        if (payload % max_fragment > 0)
+        {
+          fragments[i][j][std::max(min_fragment, payload % max_fragment)] += count;
+        }
+      }
+    }
+  }
 
+  // every mapper sends at mapper_rate, split across its flows (one per reducer
+  // and fragment size) in proportion to their bytes on the wire. all of a
+  // mapper's flows then finish together, total bytes / mapper_rate after it
+  // starts, so no flow's share sits idle once a small flow is done
+  std::vector<uint64_t> mapper_wire_bytes(n_mappers, 0);
+  for (u32 i = 0; i < n_mappers; i++)
+  {
     for (u32 j = 0; j < n_reducers; j++)
     {
-      u32 count = op_mappings[i][j];
-      // early exit if no ops mapped
-      if (count <= 0)
+      for (auto &f : fragments[i][j])
       {
-        continue;
+        mapper_wire_bytes[i] += static_cast<uint64_t>(f.first + 28) * f.second;
       }
+    }
+  }
 
+  for (u32 i = 0; i < n_mappers; i++)
+  {
+    Ptr<Node> mapper = nodes.Get(i);
+    double start = 1.0 + 0.01 * static_cast<double>(i);
+    double send_time = mapper_wire_bytes[i] * 8.0 / mapper_bps;
+
+    for (u32 j = 0; j < n_reducers; j++)
+    {
       Ipv4Address dst_addr = interfaces.GetAddress(n_mappers + j);
       u16 dst_port = base_port + j;
 
-      UdpClientHelper client(dst_addr, dst_port);
-      client.SetAttribute("MaxPackets", UintegerValue(count));
-
-      double interval = span / static_cast<double>(count);
-      // floor at 10us
-      interval = std::max(1e-5, interval);
-
-      client.SetAttribute("Interval", TimeValue(Seconds(interval)));
-      client.SetAttribute("PacketSize", UintegerValue(packet_size));
-
-      ApplicationContainer client_apps = client.Install(mapper);
-      client_apps.Start(Seconds(start));
-      client_apps.Stop(Seconds(end));
+      for (auto &f : fragments[i][j])
+      {
+        u32 size = f.first;
+        u32 count = f.second;
+
+        UdpClientHelper client(dst_addr, dst_port);
+        client.SetAttribute("MaxPackets", UintegerValue(count));
+        // flow rate = mapper_bps * flow_bytes / mapper_bytes, i.e. count packets over send_time
+        client.SetAttribute("Interval", TimeValue(Seconds(send_time / count)));
+        client.SetAttribute("PacketSize", UintegerValue(size));
+
+        ApplicationContainer client_apps = client.Install(mapper);
+        client_apps.Start(Seconds(start));
+        client_apps.Stop(Seconds(stop_time));
+      }
     }
   }
 
@@ -262,10 +310,12 @@ int main(int argc, char *argv[])
     }
   }
 
-  std::vector<u32> received_ops(n_reducers, 0);
+  std::vector<u32> received_packets(n_reducers, 0);
+  Time completion = Seconds(0);
   for (u32 i = 0; i < n_reducers; ++i)
   {
-    received_ops[i] = reducer_servers[i]->GetReceived();
+    received_packets[i] = reducer_servers[i]->GetReceived();
+    completion = std::max(completion, g_last_rx_by_reducer[i]);
   }
 
   Simulator::Destroy();
@@ -276,14 +326,28 @@ int main(int argc, char *argv[])
   std::cout << "Ops/mapper count: " << ops_per_mapper << std::endl;
   std::cout << "Total operations" << n_mappers * ops_per_mapper << std::endl;
   std::cout << "Zipf alpha: " << zipf_alpha << std::endl;
-  std::cout << "Packet size: " << packet_size << std::endl;
+  std::cout << "Default payload size: " << packet_size << std::endl;
+  std::cout << "MTU: " << mtu << std::endl;
   std::cout << "Link transfer rate: " << link_data_rate << std::endl;
+  std::cout << "Mapper send rate: " << mapper_rate << std::endl;
   std::cout << "Runtime: " << overall_delay.GetMilliSeconds() << std::endl;
+  std::cout << "Completion time: " << completion.GetMilliSeconds() << " ms" << std::endl;
 
-  std::cout << "Reducer\tPlanned\tReceived" << std::endl;
+  // completion is the arrival time of the last packet at each reducer
+  std::cout << "Reducer\tPlannedOps\tPlannedBytes\tPackets\tBytes\tCompletion(ms)" << std::endl;
   for (u32 i = 0; i < n_reducers; ++i)
   {
-    std::cout << i << "\t" << planned_reducer_ops[i] << "\t" << received_ops[i] << std::endl;
+    std::cout << i << "\t" << planned_reducer_ops[i] << "\t" << planned_reducer_bytes[i] << "\t"
+              << received_packets[i] << "\t" << g_bytes_by_reducer[i] << "\t"
+              << g_last_rx_by_reducer[i].GetMilliSeconds() << std::endl;
+  }
+
+  // a reducer completes once the slowest mapper sending to it is done, so
+  // completion follows the byte load of the mappers rather than the reducer
+  std::cout << "Mapper\tWireBytes\tSendTime(ms)" << std::endl;
+  for (u32 i = 0; i < n_mappers; ++i)
+  {
+    std::cout << i << "\t" << mapper_wire_bytes[i] << "\t" << mapper_wire_bytes[i] * 8000.0 / mapper_bps << std::endl;
   }
   std::cout << std::endl;
 
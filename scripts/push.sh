@@ -9,6 +9,7 @@ echo "Creating temp container temp_colbr..."
 docker run -d --name temp_colbr ${DOCKER_IMG} sleep infinity > /dev/null 2>&1
 echo "Copying script to conatiner..."
 docker cp ./mapreduce-sim.cc temp_colbr:/app/ns-3-dev/scratch/mapreduce-sim.cc > /dev/null 2>&1
+docker cp ./mapping-algorithm/src/rng.h temp_colbr:/app/ns-3-dev/scratch/rng.h > /dev/null 2>&1
 DIR=./mapping-algorithm/build
 F1=naive_mappings.txt
 if [ -e "$DIR/$F1" ]; then
@@ -1,3 +1,4 @@
 git clone https://gitlab.com/nsnam/ns-3-dev.git
 cd ns-3-dev
-cp ../mapreduce-sim.cc ./scratch/
\ No newline at end of file
+cp ../mapreduce-sim.cc ./scratch/
+cp ../mapping-algorithm/src/rng.h ./scratch/
\ No newline at end of file